@@ -3,17 +3,21 @@
 #include "textures_tpl.h"
 #include "udp.h"
 #include "pad_to_json.h"
+#include <algorithm>
 #include <atomic>
+#include <cmath>
 #include <cstdio>
 #include <fstream>
 #include <thread>
 #include <format>
+#include <vector>
 #include <grrlib.h>
 #include <inipp.h>
 #include <cstdlib>
 #include <wiiuse/wpad.h>
 #include <ogc/pad.h>
 #include <network.h>
+#include <ogc/lwp_watchdog.h>
 
 /**
  * Size of the send data stack.
@@ -40,6 +44,26 @@ static bool exitApp = false;
  */
 static constexpr std::uint8_t wait_time = 14;
 
+/**
+ * Time in milliseconds between checks for newly connected controllers.
+ */
+static constexpr std::uint32_t probe_interval = 1000;
+
+/**
+ * Change of a stick or trigger value needed to count as input.
+ */
+static constexpr int analog_deadband = 4;
+
+/**
+ * Change of the IR pointer position in pixels needed to count as input.
+ */
+static constexpr int pointer_deadband = 8;
+
+/**
+ * Duration in milliseconds of the self-test for each encoder.
+ */
+static constexpr std::uint32_t selftest_duration = 3000;
+
 /**
  * Callback for the reset button on the Wii.
  */
@@ -113,6 +137,11 @@ bool Application::Run()
         case appscreen::sendinput:
             screenId = screenSendInput();
             break;
+        case appscreen::selftest:
+            WPAD_ReadPending(WPAD_CHAN_ALL, nullptr); // Scan the Wii remotes
+            PAD_ScanPads(); // Scan the GC Controllers
+            screenId = screenSelfTest();
+            break;
         case appscreen::exitapp:
             [[fallthrough]];
         default:
@@ -153,6 +182,38 @@ void Application::printHeader() {
     GRRLIB_Printf(10, 10 + (15 * 4), img_font, 0xFFFFFFFF, 1, logo4);
 }
 
+/**
+ * Connect the UDP sockets to the selected IP address.
+ */
+void Application::udpConnect() {
+    // Get IP Address (without spaces)
+    ip_address = std::format("{}.{}.{}.{}", IP[0], IP[1], IP[2], IP[3]);
+
+    // Initialize the UDP connections
+    const udp_result input_result = udp_init(ip_address, port, udp_channel::input,
+        static_cast<std::uint8_t>(send_settings.input_tos));
+    udp_result bulk_result = udp_result::ok;
+    if(send_settings.bulkEnabled() == true) {
+        bulk_result = udp_init(ip_address, send_settings.bulk_port, udp_channel::bulk,
+            static_cast<std::uint8_t>(send_settings.bulk_tos));
+    }
+
+    // The IR camera must be enabled to get the raw IR dots
+    if(send_settings.ir_dots == true) {
+        WPAD_SetDataFormat(WPAD_CHAN_ALL, WPAD_FMT_BTNS_ACC_IR);
+    }
+
+    // Output the IP address
+    if(input_result == udp_result::error) {
+        msg_connected = std::format("Could not connect to {}:{}", ip_address, port);
+        return;
+    }
+    const bool tos_error = input_result == udp_result::tos_error || bulk_result == udp_result::tos_error;
+    msg_connected = std::format("Connected to {}:{}{}{}", ip_address, port,
+        bulk_result == udp_result::error ? " (bulk channel not connected)" : "",
+        tos_error ? " (Type of Service not set)" : "");
+}
+
 /**
  * Initialization screen.
  * @return Returns the appscreen to use next.
@@ -200,6 +261,7 @@ appscreen Application::screenInit() {
             ini.parse(is);
             inipp::extract(ini.sections["server"]["port"], port);
             inipp::extract(ini.sections["server"]["ipaddress"], ipaddress);
+            read_send_settings(ini, send_settings);
             is.close();
             if(struct in_addr addr; inet_aton(ipaddress.c_str(), &addr) > 0) {
                 IP = std::bit_cast<std::array<uint8_t, 4>>(addr.s_addr);
@@ -219,55 +281,224 @@ appscreen Application::screenInit() {
 }
 
 /**
- * Send pad data to UDP.
- * @param arg Unused.
- * @return Returns the appscreen to use next.
+ * Input state of a controller, used to detect activity.
  */
-static void *sendPadData([[maybe_unused]] void *arg) {
-    while(running == true) {
+struct InputState {
+    std::uint32_t buttons{0};     /**< Held buttons. */
+    std::array<int, 2> pointer{}; /**< Rounded IR pointer position. */
+    std::array<int, 6> axes{};    /**< Sticks and triggers. */
+};
+
+/**
+ * Get the input state of a Wii Remote.
+ * @param wpad The Wii Remote data, nullptr if not available.
+ * @return The input state.
+ */
+static InputState getInputState(const WPADData *wpad) {
+    InputState state;
+    if(wpad == nullptr) {
+        return state;
+    }
+    state.buttons = wpad->btns_h;
+    state.pointer = {static_cast<int>(std::round(wpad->ir.x)), static_cast<int>(std::round(wpad->ir.y))};
+    switch(wpad->exp.type) {
+        case EXP_NUNCHUK:
+            state.axes[0] = wpad->exp.nunchuk.js.pos.x;
+            state.axes[1] = wpad->exp.nunchuk.js.pos.y;
+            break;
+        case EXP_CLASSIC:
+            state.axes = {
+                wpad->exp.classic.ljs.pos.x, wpad->exp.classic.ljs.pos.y,
+                wpad->exp.classic.rjs.pos.x, wpad->exp.classic.rjs.pos.y,
+                static_cast<int>(wpad->exp.classic.l_shoulder * 255.0f),
+                static_cast<int>(wpad->exp.classic.r_shoulder * 255.0f)
+            };
+            break;
+        default:
+            break;
+    }
+    return state;
+}
+
+/**
+ * Get the input state of a GameCube Controller.
+ * @param pad The GameCube Controller status, nullptr if not available.
+ * @return The input state.
+ */
+static InputState getInputState(const PADStatus *pad) {
+    InputState state;
+    if(pad == nullptr) {
+        return state;
+    }
+    state.buttons = pad->button;
+    state.axes = {pad->stickX, pad->stickY, pad->substickX, pad->substickY, pad->triggerL, pad->triggerR};
+    return state;
+}
+
+/**
+ * Check if the input changed since the last input state.
+ * Analog values must move past a deadband so noise is not seen as activity.
+ * @param state The current input state.
+ * @param last_state The last input state, updated when the input changed.
+ * @return Returns true if the input changed.
+ */
+static bool inputChanged(const InputState& state, InputState& last_state) {
+    bool changed = state.buttons != last_state.buttons;
+    for(std::size_t i = 0; i < state.pointer.size(); ++i) {
+        if(std::abs(state.pointer[i] - last_state.pointer[i]) > pointer_deadband) {
+            changed = true;
+        }
+    }
+    for(std::size_t i = 0; i < state.axes.size(); ++i) {
+        if(std::abs(state.axes[i] - last_state.axes[i]) > analog_deadband) {
+            changed = true;
+        }
+    }
+    if(changed == true) {
+        last_state = state;
+    }
+    return changed;
+}
+
+/**
+ * Read the controllers, keeping track of the connected ones.
+ */
+class PadReader {
+    public:
+        bool Read(PADData& pad_data);
+
+    private:
+        std::uint32_t wpad_connected{0}; /**< Connected Wii Remotes, one bit per channel. */
+        std::uint32_t pad_connected{0};  /**< Connected GameCube Controllers, one bit per channel. */
+        std::uint32_t pad_missing{0};    /**< GameCube channels without a controller in the last read. */
+        std::uint64_t last_probe{0};
+        PADStatus padstatus[PAD_CHANMAX]{};
+};
+
+/**
+ * Read the connected controllers.
+ * The GameCube Controllers data stays valid until the next call.
+ * @param[out] pad_data Controllers data.
+ * @return Returns true if a controller was connected or disconnected.
+ */
+bool PadReader::Read(PADData& pad_data) {
+    const std::uint64_t now = gettime();
+    bool hotplug = false;
+
+    // Look for newly connected controllers
+    if(last_probe == 0 || diff_msec(last_probe, now) >= probe_interval) {
         for(s32 i = WPAD_CHAN_0; i < WPAD_MAX_WIIMOTES; ++i) {
+            if(u32 type; (wpad_connected & (1 << i)) == 0 && WPAD_Probe(i, &type) == WPAD_ERR_NONE) {
+                wpad_connected |= 1 << i;
+                hotplug = true;
+            }
+        }
+        // Like PAD_ScanPads, only reset the channels without a controller
+        if(pad_missing != 0) {
+            PAD_Reset(pad_missing);
+        }
+        last_probe = now;
+    }
+
+    for(s32 i = WPAD_CHAN_0; i < WPAD_MAX_WIIMOTES; ++i) {
+        if(wpad_connected & (1 << i)) {
             WPAD_ReadPending(i, nullptr);
         }
-        PADStatus padstatus[PAD_CHANMAX];
-        PAD_Read(padstatus);
+    }
+    PAD_Read(padstatus);
 
-        PADData pad_data;
-        memset(&pad_data, 0, sizeof(PADData));
+    memset(&pad_data, 0, sizeof(PADData));
 
-        if(WPADData *wpad_data0 = WPAD_Data(WPAD_CHAN_0);
-            wpad_data0->err == WPAD_ERR_NONE && wpad_data0->data_present > 0) {
-            pad_data.wpad[WPAD_CHAN_0] = wpad_data0;
+    for(s32 i = WPAD_CHAN_0; i < WPAD_MAX_WIIMOTES; ++i) {
+        if((wpad_connected & (1 << i)) == 0) {
+            continue;
         }
-        if(WPADData *wpad_data1 = WPAD_Data(WPAD_CHAN_1);
-            wpad_data1->err == WPAD_ERR_NONE && wpad_data1->data_present > 0) {
-            pad_data.wpad[WPAD_CHAN_1] = wpad_data1;
+        WPADData *wpad_data = WPAD_Data(i);
+        if(wpad_data->err == WPAD_ERR_NO_CONTROLLER) {
+            wpad_connected &= ~(1 << i);
+            hotplug = true;
         }
-        if(WPADData *wpad_data2 = WPAD_Data(WPAD_CHAN_2);
-            wpad_data2->err == WPAD_ERR_NONE && wpad_data2->data_present > 0) {
-            pad_data.wpad[WPAD_CHAN_2] = wpad_data2;
+        else if(wpad_data->err == WPAD_ERR_NONE && wpad_data->data_present > 0) {
+            pad_data.wpad[i] = wpad_data;
         }
-        if(WPADData *wpad_data3 = WPAD_Data(WPAD_CHAN_3);
-            wpad_data3->err == WPAD_ERR_NONE && wpad_data3->data_present > 0) {
-            pad_data.wpad[WPAD_CHAN_3] = wpad_data3;
+    }
+    pad_missing = 0;
+    for(s32 i = PAD_CHAN0; i < PAD_CHANMAX; ++i) {
+        const std::uint32_t bit = PAD_CHAN0_BIT >> i;
+        if(padstatus[i].err == PAD_ERR_NO_CONTROLLER) {
+            pad_missing |= bit;
         }
-        if(padstatus[PAD_CHAN0].err == PAD_ERR_NONE) {
-            pad_data.pad[PAD_CHAN0] = &padstatus[PAD_CHAN0];
+        if(padstatus[i].err == PAD_ERR_NONE) {
+            if((pad_connected & bit) == 0) {
+                pad_connected |= bit;
+                hotplug = true;
+            }
+            pad_data.pad[i] = &padstatus[i];
         }
-        if(padstatus[PAD_CHAN1].err == PAD_ERR_NONE) {
-            pad_data.pad[PAD_CHAN1] = &padstatus[PAD_CHAN1];
+        else if(padstatus[i].err == PAD_ERR_NO_CONTROLLER && (pad_connected & bit) != 0) {
+            pad_connected &= ~bit;
+            hotplug = true;
         }
-        if(padstatus[PAD_CHAN2].err == PAD_ERR_NONE) {
-            pad_data.pad[PAD_CHAN2] = &padstatus[PAD_CHAN2];
+    }
+
+    return hotplug;
+}
+
+/**
+ * Send pad data to UDP.
+ * @param arg Pointer to the SendSettings to use.
+ * @return Returns the appscreen to use next.
+ */
+static void *sendPadData(void *arg) {
+    const auto *settings = static_cast<const SendSettings*>(arg);
+    // Delay tolerant data goes on the bulk channel when it is available
+    const bool bulk_enabled = settings->bulkEnabled();
+    const JSONOptions json_options{.ir_dots = settings->ir_dots == true && bulk_enabled == false};
+
+    PadReader reader;
+    std::array<InputState, WPAD_MAX_WIIMOTES> last_wpad_state{};
+    std::array<InputState, PAD_CHANMAX> last_pad_state{};
+
+    std::uint64_t last_send = 0;
+    std::uint64_t last_bulk_send = 0;
+    std::uint64_t last_activity = gettime();
+
+    while(running == true) {
+        PADData pad_data;
+        bool activity = reader.Read(pad_data);
+        const std::uint64_t now = gettime();
+
+        for(std::size_t i = 0; i < last_wpad_state.size(); ++i) {
+            if(inputChanged(getInputState(pad_data.wpad[i]), last_wpad_state[i]) == true) {
+                activity = true;
+            }
+        }
+        for(std::size_t i = 0; i < last_pad_state.size(); ++i) {
+            if(inputChanged(getInputState(pad_data.pad[i]), last_pad_state[i]) == true) {
+                activity = true;
+            }
         }
-        if(padstatus[PAD_CHAN3].err == PAD_ERR_NONE) {
-            pad_data.pad[PAD_CHAN3] = &padstatus[PAD_CHAN3];
+        if(activity == true) {
+            last_activity = now;
         }
 
-        // Transform to JSON
-        auto msg_data = pad_to_json(pad_data);
+        // Send less often when no input was received for a while
+        const bool idle = settings->idle_timeout > 0 &&
+            diff_msec(last_activity, now) >= std::uint64_t{settings->idle_timeout} * 1000;
+        if(idle == false || diff_msec(last_send, now) >= settings->idle_interval) {
+            // Transform to JSON and send the messages
+            for(const auto& msg_data : pad_to_json_split(pad_data, UDP_MAX_PAYLOAD, json_options)) {
+                udp_print(msg_data.c_str());
+            }
+            last_send = now;
 
-        // Send the message
-        udp_print(msg_data.c_str());
+            if(bulk_enabled == true && diff_msec(last_bulk_send, now) >= settings->bulk_interval) {
+                if(const auto bulk_data = pad_to_bulk_json(pad_data); bulk_data.empty() == false) {
+                    udp_print(bulk_data.c_str(), udp_channel::bulk);
+                }
+                last_bulk_send = now;
+            }
+        }
 
         // Wait for while
         std::this_thread::sleep_for(std::chrono::milliseconds(15));
@@ -278,6 +509,53 @@ static void *sendPadData([[maybe_unused]] void *arg) {
     return nullptr;
 }
 
+/**
+ * Send pad data as fast as possible with one encoder.
+ * @param name The name of the encoder.
+ * @param encode The encoder.
+ * @param channel The channel to send the messages on.
+ * @return The result of the test.
+ */
+static SelfTestResult runSelfTest(std::string_view name,
+    std::vector<std::string> (*encode)(const PADData&), udp_channel channel) {
+    SelfTestResult result;
+    result.name = name;
+
+    PadReader reader;
+    const std::uint64_t start = gettime();
+    std::uint64_t now = start;
+    while(diff_msec(start, now) < selftest_duration) {
+        const std::uint64_t snapshot_start = gettime();
+        PADData pad_data;
+        reader.Read(pad_data);
+
+        const std::uint64_t encode_start = gettime();
+        const auto messages = encode(pad_data);
+
+        const std::uint64_t send_start = gettime();
+        for(const auto& msg_data : messages) {
+            if(udp_print(msg_data.c_str(), channel) == true) {
+                result.bytes += msg_data.size();
+            }
+            else {
+                ++result.errors;
+            }
+        }
+        const std::uint64_t send_end = gettime();
+
+        result.snapshot_time += ticks_to_microsecs(diff_ticks(snapshot_start, encode_start));
+        result.encode_time += ticks_to_microsecs(diff_ticks(encode_start, send_start));
+        result.send_time += ticks_to_microsecs(diff_ticks(send_start, send_end));
+        ++result.frames;
+        now = send_end;
+    }
+
+    // The last frame ends after the nominal duration, the rates use the measured one
+    result.duration = diff_msec(start, now);
+
+    return result;
+}
+
 /**
  * IP selection screen.
  * @return Returns the appscreen to use next.
@@ -290,21 +568,20 @@ appscreen Application::screenIpSelection() {
         return appscreen::exitapp;
     }
     if (wpad_data0->btns_d & WPAD_BUTTON_A) {
-        // Get IP Address (without spaces)
-        ip_address = std::format("{}.{}.{}.{}", IP[0], IP[1], IP[2], IP[3]);
-
-        // Output the IP address
-        msg_connected = std::format("Connected to {}:{}", ip_address, port);
-
-        // Initialize the UDP connection
-        udp_init(ip_address, port);
+        udpConnect();
 
-        if(LWP_CreateThread(&pad_data_thread, sendPadData, this, send_data_stack, STACKSIZE, 80) < 0) {
+        if(LWP_CreateThread(&pad_data_thread, sendPadData, &send_settings, send_data_stack, STACKSIZE, 80) < 0) {
             return appscreen::ipselection;
         }
 
         return appscreen::sendinput;
     }
+    if (wpad_data0->btns_d & WPAD_BUTTON_1) {
+        udpConnect();
+        selftest_frame = 0;
+        selftest_results.clear();
+        return appscreen::selftest;
+    }
 
     if (wpad_data0->btns_h & WPAD_BUTTON_LEFT  && selected_digit > 0) {
         if (wpad_data0->btns_d & WPAD_BUTTON_LEFT || wait_time_horizontal++ > wait_time) {
@@ -345,6 +622,8 @@ appscreen Application::screenIpSelection() {
     GRRLIB_Printf(10, 100 + (15 * 9), img_font, 0xFFFFFFFF, 1,
         ip_str.c_str());
 
+    GRRLIB_Printf(10, 100 + (15 * 14), img_font, 0xFFFFFFFF, 1,
+        "Press '1' to run the network self-test");
     GRRLIB_Printf(10, 100 + (15 * 15), img_font, 0xFFFFFFFF, 1,
         "Press 'A' to confirm");
     GRRLIB_Printf(10, 100 + (15 * 16), img_font, 0xFFFFFFFF, 1,
@@ -375,6 +654,7 @@ appscreen Application::screenSendInput() {
                     {"ipaddress", ip_address},
                 };
                 ini.sections.emplace("server", server_section);
+                write_send_settings(ini, send_settings);
                 ini.generate(os);
                 os.close();
             }
@@ -402,3 +682,80 @@ appscreen Application::screenSendInput() {
     // Stay on this screen
     return appscreen::sendinput;
 }
+
+/**
+ * Self-test screen.
+ * @return Returns the appscreen to use next.
+ */
+appscreen Application::screenSelfTest() {
+    if(selftest_frame < 2) {
+        // Make sure both frame buffers show the message before the test blocks
+        ++selftest_frame;
+        printHeader();
+        GRRLIB_Printf(10, 100 + (15 * 5), img_font, 0xFFFFFFFF, 1,
+            std::format("Running self-test against {}:{}...", ip_address, port).c_str());
+        return appscreen::selftest;
+    }
+
+    if(selftest_results.empty() == true) {
+        selftest_results.push_back(runSelfTest("JSON", [](const PADData& pad_data) {
+            return pad_to_json_split(pad_data, UDP_MAX_PAYLOAD);
+        }, udp_channel::input));
+        selftest_results.push_back(runSelfTest("JSON ref", [](const PADData& pad_data) {
+            return std::vector<std::string>{pad_to_json(pad_data)};
+        }, udp_channel::input));
+        // The IR camera is only enabled when the IR dots are sent
+        if(send_settings.ir_dots == true) {
+            selftest_results.push_back(runSelfTest("JSON IR", [](const PADData& pad_data) {
+                return pad_to_json_split(pad_data, UDP_MAX_PAYLOAD, {.ir_dots = true});
+            }, udp_channel::input));
+        }
+        if(send_settings.bulkEnabled() == true) {
+            selftest_results.push_back(runSelfTest("Bulk", [](const PADData& pad_data) {
+                auto bulk_data = pad_to_bulk_json(pad_data);
+                if(bulk_data.empty() == true) {
+                    return std::vector<std::string>{};
+                }
+                return std::vector<std::string>{std::move(bulk_data)};
+            }, udp_channel::bulk));
+        }
+    }
+
+    WPADData *wpad_data0 = WPAD_Data(WPAD_CHAN_0);
+
+    // If [HOME] was pressed on the first Wii Remote, break out of the loop
+    if (wpad_data0->btns_d & WPAD_BUTTON_HOME) {
+        udp_deinit();
+        return appscreen::exitapp;
+    }
+    if (wpad_data0->btns_d & WPAD_BUTTON_B) {
+        udp_deinit();
+        return appscreen::ipselection;
+    }
+
+    printHeader();
+
+    GRRLIB_Printf(10, 100 + (15 * 5), img_font, 0xFFFFFFFF, 1,
+        std::format("Self-test against {}:{}", ip_address, port).c_str());
+
+    std::uint8_t line = 6;
+    for(const auto& result : selftest_results) {
+        const std::uint32_t frames = std::max<std::uint32_t>(result.frames, 1);
+        GRRLIB_Printf(10, 100 + (15 * line++), img_font, 0xFFFFFFFF, 1,
+            std::format("{:8} {:6} frames/s {:8} bytes/s {} errors", result.name,
+                result.frames * 1000 / result.duration, result.bytes * 1000 / result.duration,
+                result.errors).c_str());
+        GRRLIB_Printf(10, 100 + (15 * line++), img_font, 0xFFFFFFFF, 1,
+            std::format("         read {} us, encode {} us, send {} us per frame",
+                result.snapshot_time / frames, result.encode_time / frames,
+                result.send_time / frames).c_str());
+    }
+
+    GRRLIB_Printf(10, 100 + (15 * 15), img_font, 0xFFFFFFFF, 1,
+        "Press 'B' to go back");
+    GRRLIB_Printf(10, 100 + (15 * 16), img_font, 0xFFFFFFFF, 1,
+        "Press the HOME button to exit");
+
+    // Stay on this screen
+    return appscreen::selftest;
+}
@@ -4,7 +4,9 @@
 #include <array>
 #include <cstdint>
 #include <string>
+#include <vector>
 #include <ogc/lwp.h>
+#include "settings.h"
 
 /**
  * Application screens.
@@ -13,7 +15,22 @@ enum class appscreen : std::uint8_t {
     initapp,    /**< Initialization screen. */
     exitapp,    /**< Exit the application. */
     ipselection,/**< IP selection screen. */
-    sendinput   /**< Send input screen. */
+    sendinput,  /**< Send input screen. */
+    selftest    /**< Throughput self-test screen. */
+};
+
+/**
+ * Result of the self-test for one encoder.
+ */
+struct SelfTestResult {
+    std::string name{};             /**< Name of the encoder. */
+    std::uint32_t duration{0};      /**< Duration of the test in milliseconds. */
+    std::uint32_t frames{0};        /**< Number of frames sent. */
+    std::uint64_t bytes{0};         /**< Number of bytes sent. */
+    std::uint32_t errors{0};        /**< Number of messages that could not be sent. */
+    std::uint64_t snapshot_time{0}; /**< Time spent reading the controllers in microseconds. */
+    std::uint64_t encode_time{0};   /**< Time spent encoding in microseconds. */
+    std::uint64_t send_time{0};     /**< Time spent sending in microseconds. */
 };
 
 struct GRRLIB_texImg;
@@ -33,9 +50,11 @@ class Application {
 
     protected:
         void printHeader();
+        void udpConnect();
         appscreen screenInit();
         appscreen screenIpSelection();
         appscreen screenSendInput();
+        appscreen screenSelfTest();
 
     private:
         GRRLIB_texImg *img_font{nullptr};
@@ -47,10 +66,15 @@ class Application {
         std::int8_t selected_digit{0};
         std::string ip_address{};
         std::uint16_t port{4242};
+        SendSettings send_settings{};
         std::string msg_connected;
         std::uint16_t holdTime{0};
         std::string pathini{};
         std::uint32_t wait_time_horizontal{0};
         std::uint32_t wait_time_vertical{0};
+
+        // Screen Self-Test
+        std::uint8_t selftest_frame{0};
+        std::vector<SelfTestResult> selftest_results{};
 };
 //---------------------------------------------------------------------------
@@ -1,32 +1,120 @@
 #include "pad_to_json.h"
+#include <algorithm>
+#include <array>
 #include <map>
 #include <cmath>
+#include <utility>
 #include "rapidjson/writer.h"
+#include "rapidjson/internal/dtoa.h"
+#include "rapidjson/internal/itoa.h"
 
 /**
  * Mask for the Wii Remote.
  */
-static const std::map wiimask = {
+static constexpr std::array wiimask_pairs = {
     std::pair{WPAD_BUTTON_LEFT, 0x0001},
-    {WPAD_BUTTON_RIGHT, 0x0002},
-    {WPAD_BUTTON_DOWN, 0x0004},
-    {WPAD_BUTTON_UP, 0x0008},
-    {WPAD_BUTTON_PLUS, 0x0010},
-    {WPAD_BUTTON_2, 0x0100},
-    {WPAD_BUTTON_1, 0x0200},
-    {WPAD_BUTTON_B, 0x0400},
-    {WPAD_BUTTON_A, 0x0800},
-    {WPAD_BUTTON_MINUS, 0x1000},
-    {WPAD_BUTTON_HOME, 0x8000},
+    std::pair{WPAD_BUTTON_RIGHT, 0x0002},
+    std::pair{WPAD_BUTTON_DOWN, 0x0004},
+    std::pair{WPAD_BUTTON_UP, 0x0008},
+    std::pair{WPAD_BUTTON_PLUS, 0x0010},
+    std::pair{WPAD_BUTTON_2, 0x0100},
+    std::pair{WPAD_BUTTON_1, 0x0200},
+    std::pair{WPAD_BUTTON_B, 0x0400},
+    std::pair{WPAD_BUTTON_A, 0x0800},
+    std::pair{WPAD_BUTTON_MINUS, 0x1000},
+    std::pair{WPAD_BUTTON_HOME, 0x8000},
 };
+static const std::map wiimask(wiimask_pairs.begin(), wiimask_pairs.end());
 
 /**
  * Mask for the Nunchuk.
  */
-static const std::map nunchukmask = {
+static constexpr std::array nunchukmask_pairs = {
     std::pair{WPAD_NUNCHUK_BUTTON_Z, 0x2000},
-    {WPAD_NUNCHUK_BUTTON_C, 0x4000}
+    std::pair{WPAD_NUNCHUK_BUTTON_C, 0x4000}
 };
+static const std::map nunchukmask(nunchukmask_pairs.begin(), nunchukmask_pairs.end());
+
+/**
+ * Remap buttons with a mask, one bit at a time.
+ * @param mask The mask.
+ * @param buttons The buttons to remap.
+ * @return The remapped buttons.
+ */
+template<typename Mask>
+[[nodiscard]] static constexpr u32 remapButtons(const Mask& mask, u32 buttons)
+{
+    u32 result = 0;
+    for(const auto& [oldid, newid] : mask)
+    {
+        if(buttons & static_cast<u32>(oldid)) {
+            result |= newid;
+        }
+    }
+    return result;
+}
+
+/**
+ * Make a lookup table remapping one byte of buttons with a mask.
+ * @param mask The mask.
+ * @param shift The position of the byte in the buttons.
+ * @return The lookup table, indexed by the byte value.
+ */
+template<typename Mask>
+[[nodiscard]] static constexpr std::array<u16, 256> makeMaskTable(const Mask& mask, unsigned shift)
+{
+    std::array<u16, 256> table{};
+    for(u32 value = 0; value < table.size(); ++value)
+    {
+        table[value] = static_cast<u16>(remapButtons(mask, value << shift));
+    }
+    return table;
+}
+
+/**
+ * Lookup tables for the Wii Remote and the Nunchuk buttons.
+ */
+static constexpr auto wiimask_low = makeMaskTable(wiimask_pairs, 0);
+static constexpr auto wiimask_high = makeMaskTable(wiimask_pairs, 8);
+static constexpr auto nunchukmask_table = makeMaskTable(nunchukmask_pairs, 16);
+
+/**
+ * Remap the Wii Remote buttons with the lookup tables.
+ * @param buttons The buttons to remap.
+ * @return The remapped buttons.
+ */
+[[nodiscard]] static constexpr u32 remapWiiButtons(u32 buttons)
+{
+    return wiimask_low[buttons & 0xFF] | wiimask_high[(buttons >> 8) & 0xFF];
+}
+
+/**
+ * Remap the Nunchuk buttons with the lookup table.
+ * @param buttons The buttons to remap.
+ * @return The remapped buttons.
+ */
+[[nodiscard]] static constexpr u32 remapNunchukButtons(u32 buttons)
+{
+    return nunchukmask_table[(buttons >> 16) & 0xFF];
+}
+
+/**
+ * Check that the lookup tables give the same result as the masks for every button.
+ * @return Returns true if the lookup tables are valid.
+ */
+[[nodiscard]] static consteval bool checkMaskTables()
+{
+    for(unsigned bit = 0; bit < 32; ++bit)
+    {
+        if(remapWiiButtons(1u << bit) != remapButtons(wiimask_pairs, 1u << bit) ||
+           remapNunchukButtons(1u << bit) != remapButtons(nunchukmask_pairs, 1u << bit))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+static_assert(checkMaskTables(), "The button lookup tables do not match the masks");
 
 /**
  * Get the calibrated stick value.
@@ -52,12 +140,56 @@ static const std::map nunchukmask = {
     }
 }
 
+/**
+ * Maximum length of the packed IR dots string.
+ */
+constexpr std::size_t IR_DOTS_MAX_LENGTH = 1 + (4 * 6);
+
+/**
+ * Pack the raw IR sensor dots in a hexadecimal string.
+ * The first digit is a mask of the visible dots (bit 0 for the first dot).
+ * It is followed by 6 digits for each visible dot, holding 10 bits for X
+ * (0-1023), 10 bits for Y (0-767) and 4 bits for the size.
+ * @param[in] ir The IR data.
+ * @param[out] buffer The buffer receiving the string, not null-terminated.
+ * @return The length of the string.
+ */
+static std::size_t packIrDots(const ir_t& ir, std::array<char, IR_DOTS_MAX_LENGTH>& buffer)
+{
+    constexpr char hex[] = "0123456789abcdef";
+
+    std::size_t length = 1;
+    u8 visible = 0;
+    for(u8 i = 0; i < 4; ++i)
+    {
+        const auto& dot = ir.dot[i];
+        if(dot.visible == 0)
+        {
+            continue;
+        }
+        visible |= 1 << i;
+
+        const u32 x = std::clamp<int>(dot.rx, 0, 1023);
+        const u32 y = std::clamp<int>(dot.ry, 0, 767);
+        const u32 size = std::min<u32>(dot.size, 15);
+        const u32 packed = (x << 14) | (y << 4) | size;
+        for(int shift = 20; shift >= 0; shift -= 4)
+        {
+            buffer[length++] = hex[(packed >> shift) & 0xF];
+        }
+    }
+    buffer[0] = hex[visible];
+
+    return length;
+}
+
 /**
  * Convert GamePad data to JSON string used by UsendMii.
  * @param[in] pad_data Controllers data.
+ * @param[in] options Conversion options.
  * @return The JSON string.
  */
-std::string pad_to_json(const PADData& pad_data)
+std::string pad_to_json(const PADData& pad_data, const JSONOptions& options)
 {
     rapidjson::StringBuffer sb;
     rapidjson::Writer<rapidjson::StringBuffer> writer(sb);
@@ -98,6 +230,13 @@ std::string pad_to_json(const PADData& pad_data)
             writer.Int(static_cast<int>(std::round(pad_data.wpad[i]->ir.x)));
             writer.Key("posY");
             writer.Int(static_cast<int>(std::round(pad_data.wpad[i]->ir.y)));
+            if(options.ir_dots == true)
+            {
+                std::array<char, IR_DOTS_MAX_LENGTH> ir_dots;
+                const auto length = packIrDots(pad_data.wpad[i]->ir, ir_dots);
+                writer.Key("irDots");
+                writer.String(ir_dots.data(), static_cast<rapidjson::SizeType>(length));
+            }
             //writer.Key("angleX");
             //writer.Double(pad_data.wpad[i]->angle.x);
             //writer.Key("angleY");
@@ -221,3 +360,426 @@ std::string pad_to_json(const PADData& pad_data)
     // Convert to string
     return sb.GetString();
 }
+
+/**
+ * String receiving the JSON written by pad_to_json_fast.
+ * Numbers are formatted with the same functions as rapidjson::Writer.
+ */
+class JSONBuffer {
+    public:
+        /**
+         * Constructor.
+         * @param capacity The number of bytes to reserve.
+         */
+        explicit JSONBuffer(std::size_t capacity = 1024) { str.reserve(capacity); }
+
+        /**
+         * Append a constant JSON fragment.
+         * @param fragment The fragment, its length is known at compile time.
+         */
+        template<std::size_t N>
+        void Literal(const char (&fragment)[N]) { str.append(fragment, N - 1); }
+
+        /**
+         * Append a string that does not need to be escaped.
+         * @param value The string.
+         * @param length The length of the string.
+         */
+        void String(const char *value, std::size_t length) {
+            str.push_back('"');
+            str.append(value, length);
+            str.push_back('"');
+        }
+
+        /**
+         * Append an unsigned integer.
+         * @param value The value.
+         */
+        void Uint(unsigned value) {
+            char buffer[10];
+            str.append(buffer, rapidjson::internal::u32toa(value, buffer));
+        }
+
+        /**
+         * Append a signed integer.
+         * @param value The value.
+         */
+        void Int(int value) {
+            char buffer[11];
+            str.append(buffer, rapidjson::internal::i32toa(value, buffer));
+        }
+
+        /**
+         * Append a number with at most 10 decimal places.
+         * Like rapidjson::Writer, nothing is written for NaN and infinity.
+         * @param value The value.
+         */
+        void Double(double value) {
+            if(std::isfinite(value) == false) {
+                return;
+            }
+            char buffer[25];
+            str.append(buffer, rapidjson::internal::dtoa(value, buffer, 10));
+        }
+
+        std::string str;
+};
+
+/**
+ * Write a Wii Remote object.
+ * @param[out] json The buffer receiving the object.
+ * @param[in] i The channel of the Wii Remote.
+ * @param[in] wpad The Wii Remote data.
+ * @param[in] options Conversion options.
+ */
+static void writeWiiRemote(JSONBuffer& json, u8 i, const WPADData& wpad, const JSONOptions& options)
+{
+    json.Literal("{\"order\":");
+    json.Uint(i + 1);
+    json.Literal(",\"hold\":");
+    json.Uint(remapWiiButtons(wpad.btns_h));
+    json.Literal(",\"posX\":");
+    json.Int(static_cast<int>(std::round(wpad.ir.x)));
+    json.Literal(",\"posY\":");
+    json.Int(static_cast<int>(std::round(wpad.ir.y)));
+    if(options.ir_dots == true)
+    {
+        std::array<char, IR_DOTS_MAX_LENGTH> ir_dots;
+        const auto length = packIrDots(wpad.ir, ir_dots);
+        json.Literal(",\"irDots\":");
+        json.String(ir_dots.data(), length);
+    }
+    switch(wpad.exp.type)
+    {
+        case EXP_NUNCHUK:
+            { // Nunchuk
+                auto js = wpad.exp.nunchuk.js;
+                auto x = getStickValue(js.pos.x, js.min.x, js.max.x, js.center.x);
+                auto y = getStickValue(js.pos.y, js.min.y, js.max.y, js.center.y);
+
+                json.Literal(",\"extension\":{\"type\":\"nunchuk\",\"hold\":");
+                json.Uint(remapNunchukButtons(wpad.btns_h));
+                json.Literal(",\"stickX\":");
+                json.Double(x);
+                json.Literal(",\"stickY\":");
+                json.Double(y);
+                json.Literal("}");
+            }
+            break;
+        case EXP_CLASSIC:
+            { // Classic Controller
+                auto ljs = wpad.exp.classic.ljs;
+                auto lx = getStickValue(ljs.pos.x, ljs.min.x, ljs.max.x, ljs.center.x);
+                auto ly = getStickValue(ljs.pos.y, ljs.min.y, ljs.max.y, ljs.center.y);
+
+                auto rjs = wpad.exp.classic.rjs;
+                auto rx = getStickValue(rjs.pos.x, rjs.min.x, rjs.max.x, rjs.center.x);
+                auto ry = getStickValue(rjs.pos.y, rjs.min.y, rjs.max.y, rjs.center.y);
+
+                json.Literal(",\"extension\":{\"type\":\"classic\",\"hold\":");
+                json.Uint(wpad.btns_h >> 16);
+                json.Literal(",\"lStickX\":");
+                json.Double(lx);
+                json.Literal(",\"lStickY\":");
+                json.Double(ly);
+                json.Literal(",\"rStickX\":");
+                json.Double(rx);
+                json.Literal(",\"rStickY\":");
+                json.Double(ry);
+                json.Literal(",\"lTrigger\":");
+                json.Double(wpad.exp.classic.l_shoulder);
+                json.Literal(",\"rTrigger\":");
+                json.Double(wpad.exp.classic.r_shoulder);
+                json.Literal("}");
+            }
+            break;
+        default:
+            break;
+    }
+    json.Literal("}"); // End wiiremote object
+}
+
+/**
+ * Write a GameCube Controller object.
+ * @param[out] json The buffer receiving the object.
+ * @param[in] i The channel of the GameCube Controller.
+ * @param[in] pad The GameCube Controller status.
+ */
+static void writeGameCubeController(JSONBuffer& json, u8 i, const PADStatus& pad)
+{
+    json.Literal("{\"order\":");
+    json.Uint(i + 1);
+    json.Literal(",\"hold\":");
+    json.Uint(pad.button);
+    json.Literal(",\"ctrlStickX\":");
+    json.Int(pad.stickX);
+    json.Literal(",\"ctrlStickY\":");
+    json.Int(pad.stickY);
+    json.Literal(",\"cStickX\":");
+    json.Int(pad.substickX);
+    json.Literal(",\"cStickY\":");
+    json.Int(pad.substickY);
+    json.Literal(",\"lTrigger\":");
+    json.Int(pad.triggerL);
+    json.Literal(",\"rTrigger\":");
+    json.Int(pad.triggerR);
+    json.Literal("}"); // End gameCubeController object
+}
+
+/**
+ * Convert GamePad data to JSON string used by UsendMii.
+ * The output is identical to pad_to_json, but the constant parts are written
+ * directly and the buttons are remapped with lookup tables.
+ * @param[in] pad_data Controllers data.
+ * @param[in] options Conversion options.
+ * @return The JSON string.
+ */
+std::string pad_to_json_fast(const PADData& pad_data, const JSONOptions& options)
+{
+    JSONBuffer json;
+
+    json.Literal("{"); // Start root object
+
+    // Wii Remotes
+    bool has_member = false;
+    bool first = true;
+    for(u8 i = 0; i < 4; ++i)
+    {
+        if(pad_data.wpad[i] == nullptr)
+        {
+            continue;
+        }
+        if(first == true)
+        {
+            json.Literal("\"wiiRemotes\":[");
+            first = false;
+        }
+        else
+        {
+            json.Literal(",");
+        }
+        writeWiiRemote(json, i, *pad_data.wpad[i], options);
+    }
+    if(first == false)
+    {
+        json.Literal("]");
+        has_member = true;
+    }
+
+    // GameCube Controllers
+    first = true;
+    for(u8 i = 0; i < PAD_CHANMAX; ++i)
+    {
+        if(pad_data.pad[i] == nullptr)
+        {
+            continue;
+        }
+        if(first == true)
+        {
+            if(has_member == true)
+            {
+                json.Literal(",");
+            }
+            json.Literal("\"gameCubeControllers\":[");
+            first = false;
+        }
+        else
+        {
+            json.Literal(",");
+        }
+        writeGameCubeController(json, i, *pad_data.pad[i]);
+    }
+    if(first == false)
+    {
+        json.Literal("]");
+    }
+
+    json.Literal("}"); // End root object
+
+    return std::move(json.str);
+}
+
+/**
+ * Convert GamePad data to the JSON string sent on the bulk channel.
+ * Only the data that can tolerate delay, like the raw IR dots, is included.
+ * @param[in] pad_data Controllers data.
+ * @return The JSON string, empty when no Wii Remote is connected.
+ */
+std::string pad_to_bulk_json(const PADData& pad_data)
+{
+    if(std::ranges::all_of(pad_data.wpad, [](const WPADData* wpad) { return wpad == nullptr; }))
+    {
+        return {};
+    }
+
+    rapidjson::StringBuffer sb;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(sb);
+
+    writer.StartObject(); // Start root object
+    writer.Key("wiiRemotes");
+    writer.StartArray();
+    for(u8 i = 0; i < 4; ++i)
+    {
+        if(pad_data.wpad[i] == nullptr)
+        {
+            continue;
+        }
+
+        std::array<char, IR_DOTS_MAX_LENGTH> ir_dots;
+        const auto length = packIrDots(pad_data.wpad[i]->ir, ir_dots);
+
+        writer.StartObject(); // Start wiiremote object
+        writer.Key("order");
+        writer.Uint(i + 1);
+        writer.Key("irDots");
+        writer.String(ir_dots.data(), static_cast<rapidjson::SizeType>(length));
+        writer.EndObject(); // End wiiremote object
+    }
+    writer.EndArray();
+    writer.EndObject(); // End root object
+
+    // Convert to string
+    return sb.GetString();
+}
+
+/**
+ * Controller objects of a message being built by pad_to_json_split.
+ */
+struct JSONMessage {
+    std::vector<const std::string*> wpad; /**< Wii Remote objects. */
+    std::vector<const std::string*> pad;  /**< GameCube Controller objects. */
+
+    /**
+     * Get the size of the message.
+     * @return The size in bytes, identical to the size of the built string.
+     */
+    [[nodiscard]] std::size_t Size() const {
+        constexpr std::size_t root_size = sizeof("{}") - 1;
+        constexpr std::size_t wpad_size = sizeof("\"wiiRemotes\":[]") - 1;
+        constexpr std::size_t pad_size = sizeof("\"gameCubeControllers\":[]") - 1;
+
+        std::size_t size = root_size;
+        for(const auto* object : wpad) {
+            size += object->size() + 1; // Object and separator
+        }
+        for(const auto* object : pad) {
+            size += object->size() + 1; // Object and separator
+        }
+        if(wpad.empty() == false) {
+            size += wpad_size - 1;
+        }
+        if(pad.empty() == false) {
+            size += pad_size - 1;
+        }
+        if(wpad.empty() == false && pad.empty() == false) {
+            size += 1; // Separator between the arrays
+        }
+        return size;
+    }
+
+    /**
+     * Build the message.
+     * @return The JSON string, identical to pad_to_json_fast for the same controllers.
+     */
+    [[nodiscard]] std::string Build() const {
+        std::string str;
+        str.reserve(Size());
+        str.push_back('{');
+        if(wpad.empty() == false) {
+            str.append("\"wiiRemotes\":[");
+            for(std::size_t i = 0; i < wpad.size(); ++i) {
+                if(i > 0) {
+                    str.push_back(',');
+                }
+                str.append(*wpad[i]);
+            }
+            str.push_back(']');
+        }
+        if(pad.empty() == false) {
+            if(wpad.empty() == false) {
+                str.push_back(',');
+            }
+            str.append("\"gameCubeControllers\":[");
+            for(std::size_t i = 0; i < pad.size(); ++i) {
+                if(i > 0) {
+                    str.push_back(',');
+                }
+                str.append(*pad[i]);
+            }
+            str.push_back(']');
+        }
+        str.push_back('}');
+        return str;
+    }
+
+    /**
+     * Check if the message has no controller.
+     * @return Returns true if the message is empty.
+     */
+    [[nodiscard]] bool Empty() const {
+        return wpad.empty() == true && pad.empty() == true;
+    }
+};
+
+/**
+ * Convert GamePad data to JSON strings that each fit in a single packet.
+ * Each controller is encoded once, then the controllers are packed in order
+ * into as few messages as possible so every packet can be parsed by UsendMii
+ * on its own. A controller larger than max_size is sent alone.
+ * @param[in] pad_data Controllers data.
+ * @param[in] max_size The maximum size of a message in bytes.
+ * @param[in] options Conversion options.
+ * @return The JSON strings.
+ */
+std::vector<std::string> pad_to_json_split(const PADData& pad_data, std::size_t max_size, const JSONOptions& options)
+{
+    std::array<std::string, 4> wpad_objects;
+    std::array<std::string, PAD_CHANMAX> pad_objects;
+
+    std::vector<std::string> messages;
+    JSONMessage message;
+
+    auto add = [&](const std::string* object, bool is_wpad) {
+        auto& objects = is_wpad ? message.wpad : message.pad;
+        const bool was_empty = message.Empty();
+        objects.push_back(object);
+        if(message.Size() > max_size && was_empty == false)
+        {
+            // Send the previous controllers and start a new message
+            objects.pop_back();
+            messages.push_back(message.Build());
+            message = JSONMessage{};
+            objects.push_back(object);
+        }
+    };
+
+    for(u8 i = 0; i < 4; ++i)
+    {
+        if(pad_data.wpad[i] == nullptr)
+        {
+            continue;
+        }
+        JSONBuffer json(256);
+        writeWiiRemote(json, i, *pad_data.wpad[i], options);
+        wpad_objects[i] = std::move(json.str);
+        add(&wpad_objects[i], true);
+    }
+    for(u8 i = 0; i < PAD_CHANMAX; ++i)
+    {
+        if(pad_data.pad[i] == nullptr)
+        {
+            continue;
+        }
+        JSONBuffer json(256);
+        writeGameCubeController(json, i, *pad_data.pad[i]);
+        pad_objects[i] = std::move(json.str);
+        add(&pad_objects[i], false);
+    }
+
+    if(message.Empty() == false || messages.empty() == true)
+    {
+        messages.push_back(message.Build());
+    }
+
+    return messages;
+}
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cstddef>
 #include <string>
+#include <vector>
 #include <wiiuse/wpad.h>
 #include <ogc/pad.h>
 
@@ -12,4 +14,14 @@ struct PADData {
     PADStatus* pad[PAD_CHANMAX]; /**< GameCube Controller. */
 };
 
-std::string pad_to_json(const PADData& pad_data);
+/**
+ * Options for the JSON conversion.
+ */
+struct JSONOptions {
+    bool ir_dots{false}; /**< Include the raw IR sensor dots of the Wii Remotes. */
+};
+
+std::string pad_to_json(const PADData& pad_data, const JSONOptions& options = {});
+std::string pad_to_json_fast(const PADData& pad_data, const JSONOptions& options = {});
+std::string pad_to_bulk_json(const PADData& pad_data);
+std::vector<std::string> pad_to_json_split(const PADData& pad_data, std::size_t max_size, const JSONOptions& options = {});
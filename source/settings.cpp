@@ -0,0 +1,50 @@
+#include "settings.h"
+#include <string>
+
+/**
+ * Read the send settings, missing or invalid values are left unchanged.
+ * @param[in] ini The parsed settings file.
+ * @param[in,out] settings The settings to update.
+ */
+void read_send_settings(inipp::Ini<char>& ini, SendSettings& settings)
+{
+    auto& server = ini.sections["server"];
+    auto& send = ini.sections["send"];
+
+    inipp::extract(server["bulk_port"], settings.bulk_port);
+    inipp::extract(send["idle_timeout"], settings.idle_timeout);
+    inipp::extract(send["idle_interval"], settings.idle_interval);
+    inipp::extract(send["bulk_interval"], settings.bulk_interval);
+
+    // inipp reads bool values as true or false only, the file uses 1 or 0
+    int ir_dots = settings.ir_dots ? 1 : 0;
+    inipp::extract(send["ir_dots"], ir_dots);
+    settings.ir_dots = ir_dots != 0;
+
+    // The Type of Service is a single byte
+    if(std::uint32_t tos; inipp::extract(send["input_tos"], tos) == true && tos <= 255) {
+        settings.input_tos = tos;
+    }
+    if(std::uint32_t tos; inipp::extract(send["bulk_tos"], tos) == true && tos <= 255) {
+        settings.bulk_tos = tos;
+    }
+}
+
+/**
+ * Write the send settings.
+ * @param[in,out] ini The settings file to update.
+ * @param[in] settings The settings to write.
+ */
+void write_send_settings(inipp::Ini<char>& ini, const SendSettings& settings)
+{
+    auto& server = ini.sections["server"];
+    auto& send = ini.sections["send"];
+
+    server["bulk_port"] = std::to_string(settings.bulk_port);
+    send["idle_timeout"] = std::to_string(settings.idle_timeout);
+    send["idle_interval"] = std::to_string(settings.idle_interval);
+    send["ir_dots"] = settings.ir_dots ? "1" : "0";
+    send["bulk_interval"] = std::to_string(settings.bulk_interval);
+    send["input_tos"] = std::to_string(settings.input_tos);
+    send["bulk_tos"] = std::to_string(settings.bulk_tos);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <inipp.h>
+
+/**
+ * Settings used when sending pad data.
+ */
+struct SendSettings {
+    std::uint32_t idle_timeout{0};    /**< Seconds without input before going idle, 0 to never go idle. */
+    std::uint32_t idle_interval{250}; /**< Milliseconds between messages when idle. */
+    bool ir_dots{false};              /**< Send the raw IR sensor dots of the Wii Remotes. */
+    std::uint16_t bulk_port{0};       /**< Port of the bulk channel, 0 to send everything on the input channel. */
+    std::uint32_t bulk_interval{50};  /**< Milliseconds between messages on the bulk channel. */
+    std::uint32_t input_tos{0};       /**< Type of Service byte of the input channel, 0 for the default. */
+    std::uint32_t bulk_tos{0};        /**< Type of Service byte of the bulk channel, 0 for the default. */
+
+    /**
+     * Check if the bulk channel is used.
+     * @return Returns true if the delay tolerant data is sent on the bulk channel.
+     */
+    [[nodiscard]] bool bulkEnabled() const {
+        return bulk_port != 0 && ir_dots == true;
+    }
+
+    bool operator==(const SendSettings&) const = default;
+};
+
+void read_send_settings(inipp::Ini<char>& ini, SendSettings& settings);
+void write_send_settings(inipp::Ini<char>& ini, const SendSettings& settings);
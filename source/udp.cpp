@@ -1,23 +1,46 @@
 #include "udp.h"
 #include <algorithm>
+#include <array>
 #include <chrono>
 #include <cstring>
 #include <thread>
 #include <network.h>
 
-static int udp_socket = -1;
-static volatile bool udp_lock = false;
+/**
+ * Number of UDP channels.
+ */
+constexpr std::size_t UDP_CHANNEL_COUNT = 2;
+
+static std::array<int, UDP_CHANNEL_COUNT> udp_socket{-1, -1};
+static std::array<volatile bool, UDP_CHANNEL_COUNT> udp_lock{false, false};
 
 /**
  * Initialize the UDP socket.
  * @param ipString The IP address to connect to.
  * @param ipport The port to connect to.
+ * @param channel The channel using this socket.
+ * @param tos The Type of Service (DSCP) byte of the packets, 0 for the default.
+ * @return The result of the initialization.
  */
-void udp_init(std::string_view ipString, std::uint16_t ipport)
+udp_result udp_init(std::string_view ipString, std::uint16_t ipport, udp_channel channel, std::uint8_t tos)
 {
-    udp_socket = net_socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
-    if (udp_socket < 0) {
-        return;
+    auto& sock = udp_socket[static_cast<std::size_t>(channel)];
+    sock = net_socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    if (sock < 0) {
+        return udp_result::error;
+    }
+
+    // Packets are still sent when the Type of Service cannot be set
+    udp_result result = udp_result::ok;
+    if (tos != 0) {
+#ifdef IP_TOS
+        std::uint32_t value = tos;
+        if (net_setsockopt(sock, IPPROTO_IP, IP_TOS, &value, sizeof(value)) < 0) {
+            result = udp_result::tos_error;
+        }
+#else
+        result = udp_result::tos_error;
+#endif
     }
 
     struct sockaddr_in connect_addr;
@@ -26,46 +49,59 @@ void udp_init(std::string_view ipString, std::uint16_t ipport)
     connect_addr.sin_port = ipport;
     inet_aton(ipString.data(), &connect_addr.sin_addr);
 
-    if(net_connect(udp_socket, reinterpret_cast<struct sockaddr*>(&connect_addr), sizeof(connect_addr)) < 0)
+    if(net_connect(sock, reinterpret_cast<struct sockaddr*>(&connect_addr), sizeof(connect_addr)) < 0)
     {
-        net_close(udp_socket);
-        udp_socket = -1;
+        net_close(sock);
+        sock = -1;
+        return udp_result::error;
     }
+
+    return result;
 }
 
 /**
- * Deinitialize the UDP socket.
+ * Deinitialize the UDP sockets.
  */
 void udp_deinit()
 {
-    if(udp_socket >= 0)
+    for(auto& sock : udp_socket)
     {
-        net_close(udp_socket);
-        udp_socket = -1;
+        if(sock >= 0)
+        {
+            net_close(sock);
+            sock = -1;
+        }
     }
 }
 
 /**
  * Print a string to the UDP socket.
+ * Strings longer than UDP_MAX_PAYLOAD are split over several packets,
+ * use pad_to_json_split to keep each message in a single packet.
  * @param str The string to send.
+ * @param channel The channel to send the string on.
+ * @return Returns false if the string could not be sent.
  */
-void udp_print(const char *str)
+bool udp_print(const char *str, udp_channel channel)
 {
-    // socket is always 0 initially as it is in the BSS
-    if(udp_socket < 0) {
-        return;
+    const auto sock = udp_socket[static_cast<std::size_t>(channel)];
+    if(sock < 0) {
+        return false;
     }
 
-    while(udp_lock == true) {
+    auto& lock = udp_lock[static_cast<std::size_t>(channel)];
+    while(lock == true) {
         std::this_thread::sleep_for(std::chrono::microseconds(1000));
     }
-    udp_lock = true;
+    lock = true;
 
+    bool result = true;
     int len = std::strlen(str);
     while (len > 0) {
-        const auto block = std::min(len, 1400); // take max 1400 bytes per UDP packet
-        const auto ret = net_send(udp_socket, str, block, 0);
+        const auto block = std::min(len, static_cast<int>(UDP_MAX_PAYLOAD));
+        const auto ret = net_send(sock, str, block, 0);
         if(ret < 0) {
+            result = false;
             break;
         }
 
@@ -73,5 +109,7 @@ void udp_print(const char *str)
         str += ret;
     }
 
-    udp_lock = false;
+    lock = false;
+
+    return result;
 }
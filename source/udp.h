@@ -1,8 +1,32 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <string_view>
 
-void udp_init(std::string_view ipString, std::uint16_t ipport);
+/**
+ * Maximum number of bytes sent in a single UDP packet.
+ */
+constexpr std::size_t UDP_MAX_PAYLOAD = 1400;
+
+/**
+ * UDP channels, each one using its own socket.
+ */
+enum class udp_channel : std::uint8_t {
+    input,  /**< Latency-critical buttons and sticks. */
+    bulk    /**< Larger data that can tolerate delay. */
+};
+
+/**
+ * Result of the UDP socket initialization.
+ */
+enum class udp_result : std::uint8_t {
+    ok,         /**< The socket is connected. */
+    error,      /**< The socket could not be connected. */
+    tos_error   /**< The socket is connected, but the Type of Service could not be set. */
+};
+
+udp_result udp_init(std::string_view ipString, std::uint16_t ipport,
+    udp_channel channel = udp_channel::input, std::uint8_t tos = 0);
 void udp_deinit();
-void udp_print(const char *str);
+bool udp_print(const char *str, udp_channel channel = udp_channel::input);
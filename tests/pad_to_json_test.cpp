@@ -0,0 +1,441 @@
+#include "pad_to_json.h"
+#include "udp.h"
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Number of test failures.
+ */
+static int failures = 0;
+
+/**
+ * Check that two JSON strings are identical.
+ * @param name The name of the check.
+ * @param expected The expected JSON string.
+ * @param actual The JSON string to check.
+ */
+static void checkEqual(std::string_view name, const std::string& expected, const std::string& actual)
+{
+    if(expected != actual)
+    {
+        ++failures;
+        std::printf("FAIL %.*s\n  expected: %s\n  actual:   %s\n",
+            static_cast<int>(name.size()), name.data(), expected.c_str(), actual.c_str());
+    }
+}
+
+/**
+ * Check that pad_to_json_fast gives the same string as pad_to_json.
+ * @param name The name of the check.
+ * @param pad_data Controllers data.
+ */
+static void checkFastEncoder(std::string_view name, const PADData& pad_data)
+{
+    for(const bool ir_dots : {false, true})
+    {
+        const JSONOptions options{.ir_dots = ir_dots};
+        checkEqual(name, pad_to_json(pad_data, options), pad_to_json_fast(pad_data, options));
+    }
+}
+
+/**
+ * Set a stick with its calibration.
+ * @param js The stick.
+ * @param pos The position.
+ * @param min The minimum value.
+ * @param max The maximum value.
+ * @param center The center value.
+ */
+static void setStick(joystick_t& js, vec2b_t pos, vec2b_t min, vec2b_t max, vec2b_t center)
+{
+    js.pos = pos;
+    js.min = min;
+    js.max = max;
+    js.center = center;
+}
+
+/**
+ * Test messages with known content.
+ */
+static void testKnownMessages()
+{
+    PADData pad_data{};
+    checkEqual("empty", "{}", pad_to_json(pad_data));
+    checkFastEncoder("empty", pad_data);
+
+    PADStatus pad{};
+    pad.button = 0x1000;
+    pad.stickX = -128;
+    pad.stickY = 127;
+    pad.substickX = -1;
+    pad.substickY = 1;
+    pad.triggerL = 255;
+    pad.triggerR = 0;
+    pad_data.pad[PAD_CHAN2] = &pad;
+    checkEqual("gamecube",
+        R"({"gameCubeControllers":[{"order":3,"hold":4096,"ctrlStickX":-128,"ctrlStickY":127,)"
+        R"("cStickX":-1,"cStickY":1,"lTrigger":255,"rTrigger":0}]})",
+        pad_to_json(pad_data));
+    checkFastEncoder("gamecube", pad_data);
+
+    WPADData wpad{};
+    wpad.btns_h = WPAD_BUTTON_A | WPAD_BUTTON_HOME | WPAD_NUNCHUK_BUTTON_Z;
+    wpad.ir.x = 100.5f;
+    wpad.ir.y = -3.4f;
+    wpad.exp.type = EXP_NUNCHUK;
+    setStick(wpad.exp.nunchuk.js, {255, 128}, {0, 0}, {255, 255}, {128, 128});
+    pad_data.wpad[WPAD_CHAN_0] = &wpad;
+    checkEqual("nunchuk",
+        R"({"wiiRemotes":[{"order":1,"hold":34816,"posX":101,"posY":-3,)"
+        R"("extension":{"type":"nunchuk","hold":8192,"stickX":0.9921875,"stickY":0.0}}],)"
+        R"("gameCubeControllers":[{"order":3,"hold":4096,"ctrlStickX":-128,"ctrlStickY":127,)"
+        R"("cStickX":-1,"cStickY":1,"lTrigger":255,"rTrigger":0}]})",
+        pad_to_json(pad_data));
+    checkFastEncoder("nunchuk", pad_data);
+
+    // Bad calibration divides by zero
+    wpad.exp.type = EXP_CLASSIC;
+    setStick(wpad.exp.classic.ljs, {10, 10}, {129, 129}, {255, 255}, {128, 128});
+    setStick(wpad.exp.classic.rjs, {200, 200}, {0, 0}, {127, 127}, {128, 128});
+    checkFastEncoder("classic calibration", pad_data);
+}
+
+/**
+ * Get the irDots value of the first Wii Remote in a message.
+ * @param message The JSON string.
+ * @return The irDots value, empty if not found.
+ */
+static std::string getIrDots(const std::string& message)
+{
+    constexpr std::string_view key = R"("irDots":")";
+    const auto start = message.find(key);
+    if(start == std::string::npos)
+    {
+        return {};
+    }
+    const auto end = message.find('"', start + key.size());
+    return message.substr(start + key.size(), end - start - key.size());
+}
+
+/**
+ * Test the packing of the IR dots.
+ */
+static void testIrDots()
+{
+    const JSONOptions options{.ir_dots = true};
+    WPADData wpad{};
+    PADData pad_data{};
+    pad_data.wpad[WPAD_CHAN_0] = &wpad;
+
+    checkEqual("no IR dots", "0", getIrDots(pad_to_json_fast(pad_data, options)));
+
+    // Mask 1, then X 1023, Y 767 and size 15 on 24 bits
+    wpad.ir.dot[0] = {.visible = 1, .x = 0, .y = 0, .rx = 1023, .ry = 767, .order = 0, .size = 15};
+    checkEqual("largest IR dot", "1ffefff", getIrDots(pad_to_json_fast(pad_data, options)));
+
+    // Out of range values are clamped
+    wpad.ir.dot[0] = {.visible = 1, .x = 0, .y = 0, .rx = 2000, .ry = 2000, .order = 0, .size = 200};
+    checkEqual("clamped IR dot", "1ffefff", getIrDots(pad_to_json_fast(pad_data, options)));
+    wpad.ir.dot[0] = {.visible = 1, .x = 0, .y = 0, .rx = -5, .ry = -5, .order = 0, .size = 0};
+    checkEqual("negative IR dot", "1000000", getIrDots(pad_to_json_fast(pad_data, options)));
+
+    // Only the second and fourth dots are visible
+    wpad.ir.dot[0] = {};
+    wpad.ir.dot[1] = {.visible = 1, .x = 0, .y = 0, .rx = 0, .ry = 0, .order = 0, .size = 0};
+    wpad.ir.dot[3] = {.visible = 1, .x = 0, .y = 0, .rx = 1, .ry = 2, .order = 0, .size = 3};
+    checkEqual("IR dots with gaps", "a000000004023", getIrDots(pad_to_json_fast(pad_data, options)));
+    checkFastEncoder("IR dots with gaps", pad_data);
+}
+
+/**
+ * Test that four Wii Remotes with a Classic Controller and all the IR dots fit in one packet.
+ */
+static void testIrDotsSize()
+{
+    WPADData wpad[WPAD_MAX_WIIMOTES]{};
+    PADData pad_data{};
+    for(int i = WPAD_CHAN_0; i < WPAD_MAX_WIIMOTES; ++i)
+    {
+        wpad[i].btns_h = 0xFFFFFFFF;
+        wpad[i].ir.x = -1000.0f;
+        wpad[i].ir.y = -1000.0f;
+        for(auto& dot : wpad[i].ir.dot)
+        {
+            dot = {.visible = 1, .x = 0, .y = 0, .rx = 1023, .ry = 767, .order = 0, .size = 15};
+        }
+        wpad[i].exp.type = EXP_CLASSIC;
+        // Calibrations giving numbers with many decimals
+        setStick(wpad[i].exp.classic.ljs, {10, 11}, {1, 2}, {250, 240}, {128, 127});
+        setStick(wpad[i].exp.classic.rjs, {13, 14}, {3, 4}, {251, 241}, {129, 126});
+        wpad[i].exp.classic.l_shoulder = 28.0f / 31.0f;
+        wpad[i].exp.classic.r_shoulder = 29.0f / 31.0f;
+        pad_data.wpad[i] = &wpad[i];
+    }
+
+    const auto message = pad_to_json_fast(pad_data, {.ir_dots = true});
+    if(message.size() > UDP_MAX_PAYLOAD)
+    {
+        ++failures;
+        std::printf("FAIL IR dots size: %zu bytes\n", message.size());
+    }
+    checkFastEncoder("IR dots size", pad_data);
+}
+
+/**
+ * Check the messages of the bulk channel.
+ */
+static void testBulkMessages()
+{
+    WPADData wpad{};
+    PADStatus pad{};
+    PADData pad_data{};
+
+    checkEqual("empty bulk", "", pad_to_bulk_json(pad_data));
+
+    // GameCube Controllers have no IR dots
+    pad_data.pad[PAD_CHAN0] = &pad;
+    checkEqual("gamecube bulk", "", pad_to_bulk_json(pad_data));
+
+    pad_data.wpad[WPAD_CHAN_1] = &wpad;
+    checkEqual("no IR dots bulk", R"({"wiiRemotes":[{"order":2,"irDots":"0"}]})", pad_to_bulk_json(pad_data));
+
+    wpad.ir.dot[0] = {.visible = 1, .x = 0, .y = 0, .rx = 1023, .ry = 767, .order = 0, .size = 15};
+    checkEqual("IR dots bulk", R"({"wiiRemotes":[{"order":2,"irDots":"1ffefff"}]})", pad_to_bulk_json(pad_data));
+}
+
+/**
+ * Generate random controllers data.
+ * @param random The random number generator.
+ * @param[out] wpad The Wii Remotes data.
+ * @param[out] pad The GameCube Controllers status.
+ * @return The controllers data, pointing to wpad and pad.
+ */
+static PADData randomPadData(std::mt19937& random, WPADData (&wpad)[WPAD_MAX_WIIMOTES], PADStatus (&pad)[PAD_CHANMAX])
+{
+    auto random_stick = [&random](joystick_t& js) {
+        const ubyte center_x = 120 + random() % 16;
+        const ubyte center_y = 120 + random() % 16;
+        setStick(js,
+            {static_cast<ubyte>(random() % 4 == 0 ? center_x : random()),
+             static_cast<ubyte>(random() % 4 == 0 ? center_y : random())},
+            {static_cast<ubyte>(random() % 64), static_cast<ubyte>(random() % 64)},
+            {static_cast<ubyte>(192 + random() % 64), static_cast<ubyte>(192 + random() % 64)},
+            {center_x, center_y});
+    };
+
+    PADData pad_data{};
+    for(int i = WPAD_CHAN_0; i < WPAD_MAX_WIIMOTES; ++i)
+    {
+        wpad[i] = WPADData{};
+        if(random() % 2 == 0)
+        {
+            continue;
+        }
+        wpad[i].btns_h = random();
+        wpad[i].ir.x = static_cast<float>(random() % 20000) / 10.0f - 500.0f;
+        wpad[i].ir.y = static_cast<float>(random() % 20000) / 10.0f - 500.0f;
+        for(auto& dot : wpad[i].ir.dot)
+        {
+            dot.visible = random() % 2;
+            dot.rx = random() % 1024;
+            dot.ry = random() % 768;
+            dot.size = random() % 16;
+        }
+        switch(random() % 3)
+        {
+            case 0:
+                wpad[i].exp.type = EXP_NUNCHUK;
+                random_stick(wpad[i].exp.nunchuk.js);
+                break;
+            case 1:
+                wpad[i].exp.type = EXP_CLASSIC;
+                random_stick(wpad[i].exp.classic.ljs);
+                random_stick(wpad[i].exp.classic.rjs);
+                wpad[i].exp.classic.l_shoulder = static_cast<float>(random() % 32) / 31.0f;
+                wpad[i].exp.classic.r_shoulder = static_cast<float>(random() % 32) / 31.0f;
+                break;
+            default:
+                wpad[i].exp.type = EXP_NONE;
+                break;
+        }
+        pad_data.wpad[i] = &wpad[i];
+    }
+    for(int i = PAD_CHAN0; i < PAD_CHANMAX; ++i)
+    {
+        pad[i] = PADStatus{};
+        if(random() % 2 == 0)
+        {
+            continue;
+        }
+        pad[i].button = random();
+        pad[i].stickX = random();
+        pad[i].stickY = random();
+        pad[i].substickX = random();
+        pad[i].substickY = random();
+        pad[i].triggerL = random();
+        pad[i].triggerR = random();
+        pad_data.pad[i] = &pad[i];
+    }
+
+    return pad_data;
+}
+
+/**
+ * Test messages with random content.
+ */
+static void testRandomMessages()
+{
+    std::mt19937 random(42);
+    for(int n = 0; n < 10000; ++n)
+    {
+        WPADData wpad[WPAD_MAX_WIIMOTES];
+        PADStatus pad[PAD_CHANMAX];
+        const PADData pad_data = randomPadData(random, wpad, pad);
+        checkFastEncoder("random", pad_data);
+    }
+}
+
+/**
+ * Count the occurrences of a string.
+ * @param str The string to search.
+ * @param value The string to count.
+ * @return The number of occurrences.
+ */
+static std::size_t countOccurrences(const std::string& str, const std::string& value)
+{
+    std::size_t count = 0;
+    for(auto pos = str.find(value); pos != std::string::npos; pos = str.find(value, pos + 1))
+    {
+        ++count;
+    }
+    return count;
+}
+
+/**
+ * Test splitting messages in packets.
+ */
+static void testSplitMessages()
+{
+    constexpr std::string_view wpad_prefix = R"({"wiiRemotes":[)";
+    constexpr std::string_view pad_prefix = R"({"gameCubeControllers":[)";
+
+    std::mt19937 random(7);
+    for(int n = 0; n < 2000; ++n)
+    {
+        WPADData wpad[WPAD_MAX_WIIMOTES];
+        PADStatus pad[PAD_CHANMAX];
+        const PADData pad_data = randomPadData(random, wpad, pad);
+        const JSONOptions options{.ir_dots = random() % 2 == 0};
+
+        // The object of each controller, as written in a message
+        std::vector<std::string> objects;
+        for(int i = WPAD_CHAN_0; i < WPAD_MAX_WIIMOTES; ++i)
+        {
+            if(pad_data.wpad[i] != nullptr)
+            {
+                PADData single_pad{};
+                single_pad.wpad[i] = pad_data.wpad[i];
+                const auto message = pad_to_json_fast(single_pad, options);
+                objects.push_back(message.substr(wpad_prefix.size(), message.size() - wpad_prefix.size() - 2));
+            }
+        }
+        for(int i = PAD_CHAN0; i < PAD_CHANMAX; ++i)
+        {
+            if(pad_data.pad[i] != nullptr)
+            {
+                PADData single_pad{};
+                single_pad.pad[i] = pad_data.pad[i];
+                const auto message = pad_to_json_fast(single_pad, options);
+                objects.push_back(message.substr(pad_prefix.size(), message.size() - pad_prefix.size() - 2));
+            }
+        }
+
+        const auto full_message = pad_to_json_fast(pad_data, options);
+        for(const std::size_t max_size : {UDP_MAX_PAYLOAD, std::size_t{600}, std::size_t{300}, std::size_t{1}})
+        {
+            const auto messages = pad_to_json_split(pad_data, max_size, options);
+
+            // A frame under the limit stays a single message
+            if(full_message.size() <= max_size)
+            {
+                if(messages.size() != 1)
+                {
+                    ++failures;
+                    std::printf("FAIL split: %zu messages for a frame of %zu bytes\n", messages.size(), full_message.size());
+                    continue;
+                }
+                checkEqual("split single", full_message, messages[0]);
+                continue;
+            }
+
+            for(const auto& message : messages)
+            {
+                // Only a single controller can be larger than the limit
+                if(message.size() > max_size && countOccurrences(message, "{\"order\":") > 1)
+                {
+                    ++failures;
+                    std::printf("FAIL split: message of %zu bytes over %zu: %s\n", message.size(), max_size, message.c_str());
+                }
+
+                // The message must be the one written for the same controllers
+                PADData subset{};
+                std::size_t index = 0;
+                for(int i = WPAD_CHAN_0; i < WPAD_MAX_WIIMOTES; ++i)
+                {
+                    if(pad_data.wpad[i] != nullptr && countOccurrences(message, objects[index++]) > 0)
+                    {
+                        subset.wpad[i] = pad_data.wpad[i];
+                    }
+                }
+                for(int i = PAD_CHAN0; i < PAD_CHANMAX; ++i)
+                {
+                    if(pad_data.pad[i] != nullptr && countOccurrences(message, objects[index++]) > 0)
+                    {
+                        subset.pad[i] = pad_data.pad[i];
+                    }
+                }
+                checkEqual("split message", pad_to_json_fast(subset, options), message);
+            }
+
+            // Every controller appears exactly once
+            for(const auto& object : objects)
+            {
+                std::size_t count = 0;
+                for(const auto& message : messages)
+                {
+                    count += countOccurrences(message, object);
+                }
+                if(count != 1)
+                {
+                    ++failures;
+                    std::printf("FAIL split: controller sent %zu times: %s\n", count, object.c_str());
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Entry point.
+ * @return Returns EXIT_SUCCESS if all tests passed.
+ */
+int main()
+{
+    testKnownMessages();
+    testIrDots();
+    testIrDotsSize();
+    testBulkMessages();
+    testRandomMessages();
+    testSplitMessages();
+
+    if(failures > 0)
+    {
+        std::printf("%d failures\n", failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
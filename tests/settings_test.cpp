@@ -0,0 +1,107 @@
+#include "settings.h"
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string_view>
+
+/**
+ * Number of test failures.
+ */
+static int failures = 0;
+
+/**
+ * Check a condition.
+ * @param name The name of the check.
+ * @param condition The condition that must be true.
+ */
+static void check(std::string_view name, bool condition)
+{
+    if(condition == false)
+    {
+        ++failures;
+        std::printf("FAIL %.*s\n", static_cast<int>(name.size()), name.data());
+    }
+}
+
+/**
+ * Read the send settings from the content of a settings file.
+ * @param content The content of the settings file.
+ * @return Returns the settings read over the default values.
+ */
+static SendSettings readSettings(const std::string& content)
+{
+    std::istringstream is(content);
+    inipp::Ini<char> ini;
+    ini.parse(is);
+    SendSettings settings{};
+    read_send_settings(ini, settings);
+    return settings;
+}
+
+/**
+ * Write the send settings and read them back.
+ * @param settings The settings to write.
+ * @return Returns the settings read back.
+ */
+static SendSettings roundTrip(const SendSettings& settings)
+{
+    inipp::Ini<char> ini;
+    write_send_settings(ini, settings);
+    std::ostringstream os;
+    ini.generate(os);
+    return readSettings(os.str());
+}
+
+/**
+ * Check that the settings are read back as written.
+ */
+static void testRoundTrip()
+{
+    check("default round trip", roundTrip(SendSettings{}) == SendSettings{});
+
+    const SendSettings settings{
+        .idle_timeout = 30,
+        .idle_interval = 500,
+        .ir_dots = true,
+        .bulk_port = 4243,
+        .bulk_interval = 100,
+        .input_tos = 184,
+        .bulk_tos = 32,
+    };
+    check("custom round trip", roundTrip(settings) == settings);
+}
+
+/**
+ * Check the values accepted for ir_dots.
+ */
+static void testIrDots()
+{
+    check("ir_dots 1", readSettings("[send]\nir_dots = 1\n").ir_dots == true);
+    check("ir_dots 0", readSettings("[send]\nir_dots = 0\n").ir_dots == false);
+    check("ir_dots missing", readSettings("[send]\n").ir_dots == false);
+    check("ir_dots invalid", readSettings("[send]\nir_dots = yes\n").ir_dots == false);
+}
+
+/**
+ * Check that a Type of Service above one byte is ignored.
+ */
+static void testTypeOfService()
+{
+    const SendSettings settings = readSettings("[send]\ninput_tos = 256\nbulk_tos = 184\n");
+    check("input_tos out of range", settings.input_tos == 0);
+    check("bulk_tos in range", settings.bulk_tos == 184);
+}
+
+int main()
+{
+    testRoundTrip();
+    testIrDots();
+    testTypeOfService();
+
+    if(failures > 0)
+    {
+        std::printf("%d failures\n", failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
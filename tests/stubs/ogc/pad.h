@@ -0,0 +1,23 @@
+#pragma once
+// Minimal subset of the libogc types used by pad_to_json, for host builds.
+
+#include <wiiuse/wpad.h>
+
+#define PAD_CHAN0 0
+#define PAD_CHAN1 1
+#define PAD_CHAN2 2
+#define PAD_CHAN3 3
+#define PAD_CHANMAX 4
+
+typedef struct _padstatus {
+    u16 button;
+    s8 stickX;
+    s8 stickY;
+    s8 substickX;
+    s8 substickY;
+    u8 triggerL;
+    u8 triggerR;
+    u8 analogA;
+    u8 analogB;
+    s8 err;
+} PADStatus;
@@ -0,0 +1,91 @@
+#pragma once
+// Minimal subset of the libogc types used by pad_to_json, for host builds.
+
+#include <cstdint>
+
+typedef std::uint8_t u8;
+typedef std::uint16_t u16;
+typedef std::uint32_t u32;
+typedef std::int8_t s8;
+typedef std::int16_t s16;
+typedef std::int32_t s32;
+typedef unsigned char ubyte;
+
+#define WPAD_CHAN_0 0
+#define WPAD_CHAN_1 1
+#define WPAD_CHAN_2 2
+#define WPAD_CHAN_3 3
+#define WPAD_MAX_WIIMOTES 4
+
+#define WPAD_BUTTON_2 0x0001
+#define WPAD_BUTTON_1 0x0002
+#define WPAD_BUTTON_B 0x0004
+#define WPAD_BUTTON_A 0x0008
+#define WPAD_BUTTON_MINUS 0x0010
+#define WPAD_BUTTON_HOME 0x0080
+#define WPAD_BUTTON_LEFT 0x0100
+#define WPAD_BUTTON_RIGHT 0x0200
+#define WPAD_BUTTON_DOWN 0x0400
+#define WPAD_BUTTON_UP 0x0800
+#define WPAD_BUTTON_PLUS 0x1000
+
+#define WPAD_NUNCHUK_BUTTON_Z (0x0001<<16)
+#define WPAD_NUNCHUK_BUTTON_C (0x0002<<16)
+
+#define EXP_NONE 0
+#define EXP_NUNCHUK 1
+#define EXP_CLASSIC 2
+#define EXP_GUITAR_HERO_3 3
+#define EXP_WII_BOARD 4
+#define EXP_MOTION_PLUS 5
+
+typedef struct vec2b_t {
+    ubyte x, y;
+} vec2b_t;
+
+typedef struct joystick_t {
+    struct vec2b_t max;
+    struct vec2b_t min;
+    struct vec2b_t center;
+    struct vec2b_t pos;
+    float ang;
+    float mag;
+} joystick_t;
+
+typedef struct nunchuk_t {
+    struct joystick_t js;
+} nunchuk_t;
+
+typedef struct classic_ctrl_t {
+    float r_shoulder;
+    float l_shoulder;
+    struct joystick_t ljs;
+    struct joystick_t rjs;
+} classic_ctrl_t;
+
+typedef struct expansion_t {
+    int type;
+    struct nunchuk_t nunchuk;
+    struct classic_ctrl_t classic;
+} expansion_t;
+
+typedef struct ir_dot_t {
+    ubyte visible;
+    u32 x, y;
+    s16 rx, ry;
+    ubyte order;
+    ubyte size;
+} ir_dot_t;
+
+typedef struct ir_t {
+    struct ir_dot_t dot[4];
+    float x, y;
+} ir_t;
+
+typedef struct _wpad_data {
+    s16 err;
+    u32 data_present;
+    u32 btns_h;
+    struct ir_t ir;
+    struct expansion_t exp;
+} WPADData;